@@ -2,46 +2,88 @@
 #include <fstream>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
 #include <vector>
 #include "json_parse.h"
+#include "json_server.h"
+#include "json_schema.h"
+#include "json_memory.h"
 
 int main(int argc, char *argv[]) {
     std::string filename = "";
+    std::string server_socket = "";
+    std::string client_socket = "";
+    std::string schema_filename = "";
+    unsigned int num_workers = 0;
+    bool use_huge_pages = false;
     for (int i = 1; i < argc; ++i) {
         if (std::strcmp(argv[i], "-h") == 0 || std::strcmp(argv[i], "--help") == 0) {
-            std::cout << "Usage: jsonparser <filename>\n\tReturns 0 if the file is valid json file else 1\n"; 
+            std::cout << "Usage: jsonparser [--schema <schema>] [--huge-pages] <filename>\n\tReturns 0 if the file is valid json file else 1\n"
+                << "\tWith --schema the file must also conform to the json schema\n"
+                << "\tWith --huge-pages tokens are stored in huge page backed memory\n"
+                << "       jsonparser --server <socket> [--workers <n>] [--schema <schema>]\n\tValidate requests sent over a unix socket\n"
+                << "       jsonparser --client <socket> <filename|->\n\tValidate file (or stdin for '-') using a running server\n"
+                << "\tThe server's --schema, if any, applies. --schema is rejected with --client\n"; 
+        }
+        else if (std::strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_socket = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+            client_socket = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--schema") == 0 && i + 1 < argc) {
+            schema_filename = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--huge-pages") == 0) {
+            use_huge_pages = true;
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            char *end;
+            errno = 0;
+            long n = std::strtol(argv[++i], &end, 10);
+            if (errno != 0 || end == argv[i] || *end != '\0' || n <= 0 || n > max_workers) {
+                std::cerr << "--workers must be a number from 1 to " << max_workers << " ==> " << argv[i] << std::endl;
+                return -1;
+            }
+            num_workers = n;
         }
         else {
             filename = argv[i];
             break;
         }
     }
-    if (filename == "") {
+    if (client_socket != "" && schema_filename != "") {
+        // The client only forwards the document. The schema is applied by the server.
+        std::cerr << "--schema must be given to --server, not --client" << std::endl;
         return -1;
     }
-    
-    std::vector<token_struct> token_list;
-    std::ifstream inf {filename};
-    if (lex(inf, token_list) != 0) {
-        return -1;
+    json_schema schema;
+    if (schema_filename != "") {
+        std::ifstream schema_inf {schema_filename};
+        if (compile_json_schema(schema_inf, schema) != 0) {
+            return -1;
+        }
     }
-    /*
-    for (int i = 0; i < token_list.size(); ++i) {
-        std::cout << token_list[i].tk_value << "|";
-    }*/
-    if (token_list.size() == 0) {
-        std::cout << "Invalid. Json must start with '{' and end with '}'" << std::endl;
-        return -1;
+    if (server_socket != "") {
+        return run_server(server_socket, num_workers, schema_filename != "" ? &schema : nullptr);
     }
-    if (token_list[0].tk_type != L_BRACE) {
-        std::cerr << "Expected Left brace at start. Found something else ==> " << token_list[0].tk_value << std::endl;
+    if (filename == "") {
         return -1;
     }
-
-    int tk_list_counter = 1;
-    if (parse_json_object(token_list, &tk_list_counter) == 0) {
-        std::cout << "valid json" << std::endl;
+    if (client_socket != "") {
+        return run_client(client_socket, filename);
     }
-
+    
+    std::ifstream inf {filename};
+    // With --huge-pages token storage, which lex() reserves up front, comes from a huge page backed arena.
+    huge_page_resource huge_pages;
+    std::pmr::monotonic_buffer_resource huge_page_arena {&huge_pages};
+    std::pmr::vector<token_struct> token_list {use_huge_pages ? &huge_page_arena : std::pmr::get_default_resource()};
+    json_schema_walker walker {schema};
+    if (validate_json(inf, token_list, schema_filename != "" ? &walker : nullptr) != 0) {
+        return -1;
+    }
+    std::cout << "valid json" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
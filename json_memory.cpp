@@ -0,0 +1,34 @@
+#include <new>
+#include <sys/mman.h>
+#include "json_memory.h"
+
+
+const std::size_t huge_page_size = 2 * 1024 * 1024;
+
+// Round bytes up to a whole number of huge pages. munmap needs the same length.
+std::size_t huge_page_length(std::size_t bytes) {
+    return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+
+// mmap returns page aligned memory which satisfies any alignment a token list needs.
+void *huge_page_resource::do_allocate(std::size_t bytes, std::size_t) {
+    std::size_t len = huge_page_length(bytes);
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+        // No reserved huge pages. Ask for transparent huge pages instead.
+        p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        madvise(p, len, MADV_HUGEPAGE);
+    }
+    return p;
+}
+
+void huge_page_resource::do_deallocate(void *p, std::size_t bytes, std::size_t) {
+    munmap(p, huge_page_length(bytes));
+}
+
+bool huge_page_resource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+// Memory resource backed by anonymous mappings on huge pages. Falls back to normal pages with transparent huge 
+// page advice when no huge pages are reserved. Meant as the upstream of a std::pmr::monotonic_buffer_resource 
+// sized for the whole token list so that the tokens of a large document need few TLB entries.
+class huge_page_resource : public std::pmr::memory_resource {
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
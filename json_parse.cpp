@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "json_parse.h"
+#include "json_schema.h"
 
 
 #define IS_HEX_CHAR(c) (c >= '0' && c <= '9' || c >= 'a' && c <= 'f' || c >= 'A' && c <= 'F') 
@@ -62,16 +63,29 @@ std::unordered_map<char, token_type> char_to_token_type_dict = {
     // Add more if necessary
 };
 
+const std::unordered_map<char, std::string> keyword_dict = {
+    {'t', "true"},
+    {'f', "false"},
+    {'n', "null"},
+};
+
 std::unordered_set<char> valid_escape_char = {
     'a', 'b', 'f', 'n', 'r', 't', 'v', '\'', '\"', '?', '\\'
 };
 
-int parse_json_number(char init_char, std::ifstream &inf, std::vector<token_struct> &token_list, int & line, int & col);
+// True if a json value can start with token of this type
+bool is_value_token(token_type type) {
+    return type == L_BRACE || type == L_BRACKET || type == KEYW_TRUE || type == KEYW_FALSE || type == KEYW_NULL 
+        || type == STRING || type == NUMBER;
+}
+
+int parse_json_number(char init_char, std::istream &inf, std::pmr::vector<token_struct> &token_list, std::string &json_num, 
+        int & line, int & col);
 void count_lines_and_col(char c, int & line, int & col, bool char_consumed=true);
 
 // Small utility function to count number of lines and col when char c is consumed/put back from/into input stream
 void count_lines_and_col(char c, int & line, int & col, bool char_consumed) {
-    static int old_col = 1; // used to reset when a character is put back into input stream
+    thread_local int old_col = 1; // used to reset when a character is put back into input stream. Per thread for server mode.
     if (c == '\n') {
         if (char_consumed) {
             old_col = col; // Store
@@ -94,11 +108,14 @@ void count_lines_and_col(char c, int & line, int & col, bool char_consumed) {
 }
 
 // Accumulate and Accept/Reject Json string using a DFA. Final state: accepted_end_quote.
-int parse_json_string(char init_char, std::ifstream &inf, std::vector<token_struct> &token_list, int & line, int & col) {
+// The string is accumulated in json_string and the token is pushed with an empty value. lex() decides once it sees
+// the next token whether the string is an object key or needs its value copied.
+int parse_json_string(char init_char, std::istream &inf, std::pmr::vector<token_struct> &token_list, std::string &json_string, 
+        int & line, int & col) {
     char c = init_char;
     char temp_c = c, count = 0;
-    std::string json_string = "";
-    token_struct tk {STRING, json_string, line, col};
+    json_string.clear();
+    token_struct tk {STRING, -1, std::pmr::string(token_list.get_allocator()), line, col};
     parse_json_string_state curr_state = parse_json_string_state::init_state;
     count_lines_and_col(c, line, col, false); // Reset done so that this function inside the do while loop works correctly.
 
@@ -145,12 +162,14 @@ int parse_json_string(char init_char, std::ifstream &inf, std::vector<token_stru
                 temp_c = c;
                 count = 0;
                 do {
-                    count_lines_and_col(temp_c, line, col);
+                    if (count > 0) { // First hex digit is c which is counted and accumulated outside this loop
+                        count_lines_and_col(temp_c, line, col);
+                        hex_digits += temp_c;
+                    }
                     if (!IS_HEX_CHAR(temp_c)) {
                         std::cerr << "Error. Not a hex digit ==> " << temp_c << std::endl;
                         return -1;
                     }
-                    hex_digits += temp_c;
                     ++count;
                     if (count == 4) break;
                 } while (inf.get(temp_c));
@@ -177,8 +196,7 @@ int parse_json_string(char init_char, std::ifstream &inf, std::vector<token_stru
     } while (inf.get(c));
 
     // Case when we run out of characters from input stream before we reach final state.
-    tk.tk_value = json_string;
-    token_list.push_back(tk);
+    token_list.push_back(std::move(tk));
     return 0; // success
 
 
@@ -191,12 +209,14 @@ print_error_and_return:
 // Accumulate and Accept/Reject Json number using a DFA.
 // Final states have push_char_back_to_istream_and_end_parse as error handling while non-final states 
 // have print_error_and_return as its error handling
-int parse_json_number(char init_char, std::ifstream &inf, std::vector<token_struct> &token_list, int & line, int & col) {
+// The number is accumulated in json_num and copied into the token once complete.
+int parse_json_number(char init_char, std::istream &inf, std::pmr::vector<token_struct> &token_list, std::string &json_num, 
+        int & line, int & col) {
     
-    std::string json_num = ""; // accumulated json number to be added to token_list at the end
+    json_num.clear();
     char c = init_char;
     parse_json_num_state curr_state = parse_json_num_state::init_state;
-    token_struct tk = {NUMBER, json_num, line, col};
+    token_struct tk = {NUMBER, -1, std::pmr::string(token_list.get_allocator()), line, col};
     count_lines_and_col(c, line, col, false); // Reset done so that this function inside the do while loop works correctly.
     do {
         count_lines_and_col(c, line, col);
@@ -300,8 +320,8 @@ int parse_json_number(char init_char, std::ifstream &inf, std::vector<token_stru
     } while (inf.get(c));
 
     // Case when we run out of characters from input stream
-    tk.tk_value = json_num;
-    token_list.push_back(tk);
+    tk.tk_value.assign(json_num);
+    token_list.push_back(std::move(tk));
     return 0; // success
 
 print_error_and_return:
@@ -312,20 +332,145 @@ print_error_and_return:
 push_char_back_to_istream_and_end_parse:
     //std::cout << "Pushback char to ifsteam: " << c << std::endl;
     inf.putback(c);
-    tk.tk_value = json_num;
+    tk.tk_value.assign(json_num);
     count_lines_and_col(c, line, col, false); // Reset line count
-    token_list.push_back(tk);
+    token_list.push_back(std::move(tk));
     return 0; // success
 }
  
+// Return id of key. context is the context of its object (see object_keys) and position the number of keys 
+// before it in the object.
+int json_symbol_table::intern(std::string_view key, int context, int position) {
+    if (static_cast<size_t>(position) < object_keys[context].size()) {
+        int predicted = object_keys[context][position];
+        if (names[predicted] == key) {
+            return predicted; // Same key order as the previous object of this context
+        }
+    }
+
+    int id;
+    auto it = ids.find(key);
+    if (it != ids.end()) {
+        id = it->second;
+    }
+    else {
+        id = names.size();
+        names.emplace_back(key);
+        ids.emplace(names.back(), id);
+        object_keys.emplace_back();
+        key_object.push_back(0);
+    }
+    std::vector<int> &keys = object_keys[context];
+    if (static_cast<size_t>(position) < keys.size()) {
+        keys[position] = id;
+    }
+    else {
+        keys.push_back(id);
+    }
+    return id;
+}
+
+// Record key_id in the open object numbered object. Return false if it was already seen in that object.
+bool json_symbol_table::add_object_key(int object, int key_id) {
+    if (key_id < 0) {
+        return true; // Not followed by ':'. The parser rejects it as a key anyway.
+    }
+    int &last = key_object[key_id];
+    if (last == object) {
+        return false;
+    }
+    key_object_undo.emplace_back(key_id, last);
+    last = object;
+    return true;
+}
+
+// Called at the end of an object with the length key_object_undo had at its start. Gives keys of the enclosing 
+// objects their stamps back.
+void json_symbol_table::end_object(size_t undo_len) {
+    while (key_object_undo.size() > undo_len) {
+        key_object[key_object_undo.back().first] = key_object_undo.back().second;
+        key_object_undo.pop_back();
+    }
+}
+
+std::string_view token_text(const token_struct &tk, const json_symbol_table &symbols) {
+    if (tk.key_id >= 0) {
+        return symbols.names[tk.key_id];
+    }
+    return tk.tk_value;
+}
+
+// Forget all keys. Key ids are per document so a table must be cleared before it is reused.
+void json_symbol_table::clear() {
+    ids.clear();
+    names.clear();
+    object_keys.clear();
+    object_keys.emplace_back();
+    key_object.clear();
+    key_object_undo.clear();
+    num_objects = 0;
+}
+
+// Upper bound of the number of tokens in a valid json document, found by a quick pre-count of structural 
+// characters outside strings. Every scalar value follows '[', ',' or ':' (or starts the document) so there are 
+// at most 2 * structural + 1 tokens. Stream is rewound to where it was. Return 0 if the stream can't seek.
+size_t estimate_token_capacity(std::istream &inf) {
+    std::streampos start = inf.tellg();
+    if (start == std::streampos(-1)) {
+        return 0;
+    }
+
+    size_t structural = 0;
+    bool in_string = false, escaped = false;
+    char buf[1 << 16];
+    while (inf.read(buf, sizeof(buf)) || inf.gcount() > 0) {
+        std::streamsize n = inf.gcount();
+        for (std::streamsize i = 0; i < n; ++i) {
+            char c = buf[i];
+            if (in_string) {
+                if (escaped) {
+                    escaped = false;
+                }
+                else if (c == '\\') {
+                    escaped = true;
+                }
+                else if (c == d_quote) {
+                    in_string = false;
+                }
+            }
+            else if (c == d_quote) {
+                in_string = true;
+            }
+            else if (c == l_brace || c == r_brace || c == l_bracket || c == r_bracket || c == comma || c == colon) {
+                ++structural;
+            }
+        }
+    }
+
+    inf.clear();
+    inf.seekg(start);
+    return 2 * structural + 1;
+}
+
 // Divide the input into different tokens. Return -1 if there's an error else 0 for success.
-int lex(std::ifstream &inf, std::vector<token_struct> &token_list) {
+// String tokens followed by ':' inside an object are keys. They get their key_id from symbols and keep no value 
+// of their own.
+// token_list is reserved for estimate_token_capacity() more tokens first if its spare capacity is smaller, so that 
+// lexing a valid document never reallocates, also when a warm token_list is reused for a larger document. 
+// Pass a token_list with its own memory resource to control where tokens live.
+// Scratch buffers come from buffers so that a caller lexing many documents can keep their capacity.
+int lex(std::istream &inf, std::pmr::vector<token_struct> &token_list, json_symbol_table &symbols, 
+        json_lex_buffers &buffers) {
+    size_t estimate = estimate_token_capacity(inf);
+    if (token_list.capacity() - token_list.size() < estimate) {
+        token_list.reserve(token_list.size() + estimate);
+    }
 
-    std::unordered_map <char, std::string> m_str_dict = {
-                {'t', "true"},
-                {'f', "false"},
-                {'n', "null"},
-    };
+    std::vector<lex_open_object> &open_objects = buffers.open_objects;
+    std::string &json_string = buffers.json_string;
+    std::string &json_num = buffers.json_num;
+    open_objects.clear();
+    bool string_pending = false;
 
     int line = 1, col = 0; // Keep track of line and column number of input stream.
     char c;
@@ -333,27 +478,46 @@ int lex(std::ifstream &inf, std::vector<token_struct> &token_list) {
         
         count_lines_and_col(c, line, col);
         
+        if (string_pending && !std::isspace(c)) {
+            token_struct &tk = token_list.back();
+            if (c == colon && !open_objects.empty()) {
+                lex_open_object &obj = open_objects.back();
+                tk.key_id = symbols.intern(json_string, obj.context, obj.position++);
+                obj.last_key = tk.key_id;
+            }
+            else {
+                tk.tk_value.assign(json_string);
+            }
+            string_pending = false;
+        }
+
         if (c == l_brace || c == r_brace || c == l_bracket || c == r_bracket || c == comma || c == colon) {
-            std::string temp_s {c};
-            token_struct tk {char_to_token_type_dict[c], temp_s, line, col};
-            token_list.push_back(tk);
-            //std::cout << temp_s;
+            token_struct tk {char_to_token_type_dict.at(c), -1, std::pmr::string(1, c, token_list.get_allocator()), line, col};
+            if (c == l_brace) {
+                int context = open_objects.empty() ? 0 : open_objects.back().last_key + 1;
+                open_objects.push_back({context, 0, -1});
+            }
+            else if (c == r_brace && !open_objects.empty()) {
+                open_objects.pop_back();
+            }
+            token_list.push_back(std::move(tk));
         }
         else if (std::isspace(c)) {
             // throw away
         }
         else if (c == d_quote) {
             // Start of a json string. Keep iterating till we find matching end quote or end of input.
-            if (parse_json_string(c, inf, token_list, line, col) != 0) {
+            if (parse_json_string(c, inf, token_list, json_string, line, col) != 0) {
                 return -1; // error
             }
+            string_pending = true;
         }
         else if (c == 't' || c == 'f' || c == 'n') {
             // keyword = true or false or null
             char temp_c;
-            std::string m_str = m_str_dict[c];
+            const std::string &m_str = keyword_dict.at(c);
             std::string s_read {c};
-            token_struct tk {char_to_token_type_dict[c], s_read, line, col};
+            token_struct tk {char_to_token_type_dict.at(c), -1, std::pmr::string(token_list.get_allocator()), line, col};
             int i = 0;
             // read exactly as many characters as m_str characters and see if it matches
             while (inf.get(temp_c)) {
@@ -370,12 +534,12 @@ int lex(std::ifstream &inf, std::vector<token_struct> &token_list) {
                 std::cerr << "Lex: Unexpected keyword ==> '" << s_read << "'" << "at line " << line << " col " << col << std::endl;
                 return -1; // error
             }
-            tk.tk_value = s_read;
-            token_list.push_back(tk);
+            tk.tk_value.assign(s_read);
+            token_list.push_back(std::move(tk));
         }
         else if (c >= '0' && c <= '9' || c == minus) {
             // start json number
-            if (parse_json_number(c, inf, token_list, line, col) != 0) {
+            if (parse_json_number(c, inf, token_list, json_num, line, col) != 0) {
                 return -1; // error
             }
         }
@@ -385,6 +549,10 @@ int lex(std::ifstream &inf, std::vector<token_struct> &token_list) {
         }
     }
 
+    if (string_pending) {
+        token_list.back().tk_value.assign(json_string);
+    }
+
     return 0; // Success
 }
 
@@ -395,17 +563,27 @@ int lex(std::ifstream &inf, std::vector<token_struct> &token_list) {
 
 // Json list starts with '[' and ends with ']'. Different values are separated by ','. Calling this function means 
 // we have already seen the starting '['
-int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr) {
+int parse_json_list(std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, json_symbol_table &symbols, 
+        json_schema_walker *walker, int schema_node) {
     
     parse_json_list_state curr_state = parse_json_list_state::accept_list_value_or_end_bracket;
+    int item_node = walker ? walker->items_node(schema_node) : -1; // schema for every value of this list
+    int item_index = 0;
+    size_t pointer_len = 0;
     while (*tk_index_ptr < token_list.size()) {
         token_struct &tk = token_list[*tk_index_ptr];
         (*tk_index_ptr)++;
         switch(curr_state) {
             case parse_json_list_state::accept_list_value_or_end_bracket:
+                if (walker && is_value_token(tk.tk_type)) {
+                    pointer_len = walker->push_index(item_index++);
+                    if (walker->check_value(item_node, tk) != 0) {
+                        return -1;
+                    }
+                }
                 if (tk.tk_type == L_BRACKET) {
                     // start of another json list
-                    if (parse_json_list(token_list, tk_index_ptr) != 0) {
+                    if (parse_json_list(token_list, tk_index_ptr, symbols, walker, item_node) != 0) {
                         return -1; // Parse fail
                     }
                     curr_state = parse_json_list_state::accept_comma_or_end_bracket;
@@ -416,7 +594,7 @@ int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr) {
                 }
                 else if (tk.tk_type == L_BRACE) {
                     // start of json object
-                    if (parse_json_object(token_list, tk_index_ptr) != 0) {
+                    if (parse_json_object(token_list, tk_index_ptr, symbols, walker, item_node) != 0) {
                         return -1;
                     }
                     curr_state = parse_json_list_state::accept_comma_or_end_bracket;
@@ -427,21 +605,30 @@ int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr) {
                         curr_state = parse_json_list_state::accept_comma_or_end_bracket;
                 }
                 else {
-                    std::cerr << tk.line << ":" << tk.col << "Json list parsing error: Unexpected token ==> " << tk.tk_value;
+                    std::cerr << tk.line << ":" << tk.col << "Json list parsing error: Unexpected token ==> " << token_text(tk, symbols);
                     return -1;
                 }
+                if (walker) {
+                    walker->pop(pointer_len);
+                }
                 break;
             case parse_json_list_state::accept_list_value:
+                if (walker && is_value_token(tk.tk_type)) {
+                    pointer_len = walker->push_index(item_index++);
+                    if (walker->check_value(item_node, tk) != 0) {
+                        return -1;
+                    }
+                }
                 if (tk.tk_type == L_BRACKET) {
                     // start of another json list
-                    if (parse_json_list(token_list, tk_index_ptr) != 0) {
+                    if (parse_json_list(token_list, tk_index_ptr, symbols, walker, item_node) != 0) {
                         return -1; // Parse fail
                     }
                     curr_state = parse_json_list_state::accept_comma_or_end_bracket;
                 }
                 else if (tk.tk_type == L_BRACE) {
                     // start of json object
-                    if (parse_json_object(token_list, tk_index_ptr) != 0) {
+                    if (parse_json_object(token_list, tk_index_ptr, symbols, walker, item_node) != 0) {
                         return -1;
                     }
                     curr_state = parse_json_list_state::accept_comma_or_end_bracket;
@@ -452,9 +639,12 @@ int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr) {
                         curr_state = parse_json_list_state::accept_comma_or_end_bracket;
                 }
                 else {
-                    std::cerr << tk.line << ":" << tk.col << " Json list parsing error: Unexpected token ==> " << tk.tk_value;
+                    std::cerr << tk.line << ":" << tk.col << " Json list parsing error: Unexpected token ==> " << token_text(tk, symbols);
                     return -1;
                 }
+                if (walker) {
+                    walker->pop(pointer_len);
+                }
                 break;
             case parse_json_list_state::accept_comma_or_end_bracket:
                 if (tk.tk_type == COMMA) {
@@ -464,7 +654,7 @@ int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr) {
                     return 0; // Json list end and hence parse successful.
                 }
                 else {
-                    std::cerr << tk.line << ":" << tk.col << " Json list parsing error: Unexpected token ==> " << tk.tk_value;
+                    std::cerr << tk.line << ":" << tk.col << " Json list parsing error: Unexpected token ==> " << token_text(tk, symbols);
                     return -1;
                 }
                 break;
@@ -477,10 +667,15 @@ int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr) {
 
 // Json object starts with '{' and ends with '}'. Contains different key value pairs separated by ":". Different key-values are separated by ','. 
 // Calling this function means we have already seen the starting '{'. Keys must be unique in a json object.
-int parse_json_object(std::vector<token_struct> &token_list, int *tk_index_ptr) {
+int parse_json_object(std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, json_symbol_table &symbols, 
+        json_schema_walker *walker, int schema_node) {
     
     parse_json_obj_state curr_state = parse_json_obj_state::accept_key_or_end_brace;
-    std::unordered_set<std::string> json_keys; // to keep keys unique.
+    int object_id = ++symbols.num_objects; // To keep keys unique
+    size_t undo_len = symbols.key_object_undo.size();
+    size_t seen_base = walker ? walker->begin_object(schema_node) : 0; // schema keys seen so far
+    int value_node = -1; // schema for value of the current key
+    size_t pointer_len = 0;
     
     while (*tk_index_ptr < token_list.size()) {
         token_struct &tk = token_list[*tk_index_ptr];
@@ -488,36 +683,50 @@ int parse_json_object(std::vector<token_struct> &token_list, int *tk_index_ptr)
         switch(curr_state) {
             case parse_json_obj_state::accept_key_or_end_brace:
                 if (tk.tk_type == STRING) {
-                    if (json_keys.find(tk.tk_value) == json_keys.end()) {
-                        json_keys.insert(tk.tk_value);
+                    if (symbols.add_object_key(object_id, tk.key_id)) {
+                        if (walker) {
+                            int slot = walker->key_slot(schema_node, tk);
+                            if (slot >= 0) {
+                                walker->seen_slots[seen_base + slot] = true;
+                            }
+                            value_node = walker->slot_node(schema_node, slot);
+                            pointer_len = walker->push_key(tk);
+                        }
                         curr_state = parse_json_obj_state::accept_colon;
                     }
                     else {
-                        std::cerr << "Duplicate key not allowed ==> " << tk.tk_value << "line " << tk.line << "col " << tk.col;
+                        std::cerr << "Duplicate key not allowed ==> " << token_text(tk, symbols) << "line " << tk.line << "col " << tk.col;
                         return -1;
                     }
                 }
                 else if (tk.tk_type == R_BRACE) {
-                    return 0; // Parse successful
+                    goto end_of_object; // Parse successful
                 }
                 else {
-                    std::cerr << "Expected either a string or end brace '}' ==> " << tk.tk_value << "line " << tk.line << "col " << tk.col;
+                    std::cerr << "Expected either a string or end brace '}' ==> " << token_text(tk, symbols) << "line " << tk.line << "col " << tk.col;
                     return -1;
                 }
                 break;
             case parse_json_obj_state::accept_key:
                 if (tk.tk_type == STRING) {
-                    if (json_keys.find(tk.tk_value) == json_keys.end()) {
-                        json_keys.insert(tk.tk_value);
+                    if (symbols.add_object_key(object_id, tk.key_id)) {
+                        if (walker) {
+                            int slot = walker->key_slot(schema_node, tk);
+                            if (slot >= 0) {
+                                walker->seen_slots[seen_base + slot] = true;
+                            }
+                            value_node = walker->slot_node(schema_node, slot);
+                            pointer_len = walker->push_key(tk);
+                        }
                         curr_state = parse_json_obj_state::accept_colon;
                     }
                     else {
-                        std::cerr << "Duplicate key not allowed ==> " << tk.tk_value << "line " << tk.line << "col " << tk.col;
+                        std::cerr << "Duplicate key not allowed ==> " << token_text(tk, symbols) << "line " << tk.line << "col " << tk.col;
                         return -1;
                     }
                 }
                 else {
-                    std::cerr << "Only strings allowed as keys ==> " << tk.tk_value << "line " << tk.line << "col " << tk.col;
+                    std::cerr << "Only strings allowed as keys ==> " << token_text(tk, symbols) << "line " << tk.line << "col " << tk.col;
                     return -1;
                 }
                 break;
@@ -526,25 +735,31 @@ int parse_json_object(std::vector<token_struct> &token_list, int *tk_index_ptr)
                     curr_state = parse_json_obj_state::accept_value;
                 }
                 else {
-                    std::cerr << "Expected colon. Found something else ==> " << tk.tk_value << "line " << tk.line << "col " << tk.col;
+                    std::cerr << "Expected colon. Found something else ==> " << token_text(tk, symbols) << "line " << tk.line << "col " << tk.col;
                     return -1;
                 }
                 break;
             case parse_json_obj_state::accept_value:
+                if (walker && is_value_token(tk.tk_type) && walker->check_value(value_node, tk) != 0) {
+                    return -1;
+                }
                 if (tk.tk_type == L_BRACE) {
                     // Start of another json object
-                    if (parse_json_object(token_list, tk_index_ptr) != 0) {
+                    if (parse_json_object(token_list, tk_index_ptr, symbols, walker, value_node) != 0) {
                         return -1;
                     }
                     curr_state = parse_json_obj_state::accept_comma_or_end_brace;
                 }
                 else if (tk.tk_type == R_BRACE) {
                     // End of json object
-                    return 0; // successful parsing
+                    if (walker) {
+                        walker->pop(pointer_len);
+                    }
+                    goto end_of_object; // successful parsing
                 }
                 else if (tk.tk_type == L_BRACKET) {
                     // Start of json list
-                    if (parse_json_list(token_list, tk_index_ptr) != 0) {
+                    if (parse_json_list(token_list, tk_index_ptr, symbols, walker, value_node) != 0) {
                         return -1;
                     }
                     curr_state = parse_json_obj_state::accept_comma_or_end_brace;
@@ -555,19 +770,22 @@ int parse_json_object(std::vector<token_struct> &token_list, int *tk_index_ptr)
                     curr_state = parse_json_obj_state::accept_comma_or_end_brace;
                 }
                 else {
-                    std::cerr << "Unexpected token ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col;
+                    std::cerr << "Unexpected token ==> " << token_text(tk, symbols) << " line " << tk.line << " col " << tk.col;
                     return -1; 
                 }
+                if (walker) {
+                    walker->pop(pointer_len);
+                }
                 break;
             case parse_json_obj_state::accept_comma_or_end_brace:
                 if (tk.tk_type == COMMA) {
                     curr_state = parse_json_obj_state::accept_key;
                 }
                 else if (tk.tk_type == R_BRACE) {
-                    return 0; // json obj end.
+                    goto end_of_object; // json obj end.
                 }
                 else {
-                    std::cerr << "Unexpected comma ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col;
+                    std::cerr << "Unexpected comma ==> " << token_text(tk, symbols) << " line " << tk.line << " col " << tk.col;
                     return -1; 
                 }
                 break;
@@ -576,4 +794,57 @@ int parse_json_object(std::vector<token_struct> &token_list, int *tk_index_ptr)
 
     // If control reaches this point, it means we have exhausted the token_list and still not seen closing brace.
     return -1;
-}
\ No newline at end of file
+
+end_of_object:
+    symbols.end_object(undo_len);
+    // All keys of the object have been seen. Check the ones required by schema.
+    if (walker && walker->check_required(schema_node, seen_base) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Lex and parse a whole json document from input stream. token_list and symbols are cleared first so that callers 
+// can reuse token_list and lex_buffers across documents. Return 0 if the document is valid json else -1.
+int validate_json(std::istream &inf, std::pmr::vector<token_struct> &token_list, json_schema_walker *walker, 
+        json_symbol_table *symbols, json_lex_buffers *lex_buffers) {
+    json_symbol_table local_symbols;
+    json_lex_buffers local_lex_buffers;
+    if (symbols == nullptr) {
+        symbols = &local_symbols;
+    }
+    if (lex_buffers == nullptr) {
+        lex_buffers = &local_lex_buffers;
+    }
+    token_list.clear();
+    symbols->clear();
+    if (lex(inf, token_list, *symbols, *lex_buffers) != 0) {
+        return -1;
+    }
+    if (token_list.size() == 0) {
+        std::cerr << "Invalid. Json must start with '{' and end with '}'" << std::endl;
+        return -1;
+    }
+    if (token_list[0].tk_type != L_BRACE) {
+        std::cerr << "Expected Left brace at start. Found something else ==> " << token_text(token_list[0], *symbols) << std::endl;
+        return -1;
+    }
+
+    if (walker) {
+        walker->reset();
+        walker->symbols = symbols;
+        if (walker->check_value(0, token_list[0]) != 0) {
+            return -1;
+        }
+    }
+
+    int tk_list_counter = 1;
+    if (parse_json_object(token_list, &tk_list_counter, *symbols, walker, walker ? 0 : -1) != 0) {
+        return -1;
+    }
+    if (static_cast<size_t>(tk_list_counter) != token_list.size()) {
+        std::cerr << "Unexpected token after end of json ==> " << token_text(token_list[tk_list_counter], *symbols) << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -1,5 +1,10 @@
+#pragma once
 #include <string>
+#include <string_view>
+#include <deque>
+#include <istream>
 #include <vector>
+#include <memory_resource>
 #include <unordered_map>
 
 using std::string;
@@ -32,7 +37,11 @@ typedef enum {
  
 struct token_struct {
     token_type tk_type; 
-    std::string tk_value;
+    // Id of the key in json_symbol_table if this string token is an object key else -1. tk_value of keys is empty.
+    // Placed here so that it fits in padding before tk_value.
+    int key_id;
+    // Allocated from the memory resource of the token list it is lexed into.
+    std::pmr::string tk_value;
     // Line and column number of start of token character from the original input
     int line;
     int col;
@@ -41,7 +50,57 @@ struct token_struct {
     //    tk_type {type}, tk_value {value}, line {line}, col {col} {}
 };
 
+// Per document symbol table of object keys. A key gets a small integer id the first time it is seen and every 
+// later occurrence shares it. For arrays of records with the same keys, the key at the same position of the 
+// previous object under the same parent key is tried first so that most lookups are a single string compare 
+// without hashing. Nested objects that reuse key names (an "id" in a record and in its "owner") are predicted 
+// separately.
+// Key tokens carry only their key_id. Their text is kept once per distinct key in names.
+struct json_symbol_table {
+    std::deque<std::string> names; // id -> key. A deque so that views of the keys in ids stay valid as it grows.
+    std::unordered_map<std::string_view, int> ids;
+    // Keys of the last object lexed in each context, in order. Context 0 is for objects which are not inside the 
+    // value of a key (the root) and parent key id + 1 for the others.
+    std::vector<std::vector<int>> object_keys = std::vector<std::vector<int>>(1);
 
-int lex(std::ifstream &inf, std::vector<token_struct> &token_list);
-int parse_json_list(std::vector<token_struct> &token_list, int *tk_index_ptr);
-int parse_json_object(std::vector<token_struct> &token_list, int *tk_index_ptr);
\ No newline at end of file
+    // Duplicate key detection while parsing. Per key id, number of the open object it was last seen in (0 if none).
+    // Stamps overwritten by a nested object are logged in key_object_undo and restored when it ends.
+    std::vector<int> key_object;
+    std::vector<std::pair<int, int>> key_object_undo;
+    int num_objects = 0;
+
+    int intern(std::string_view key, int context, int position);
+    bool add_object_key(int object, int key_id);
+    void end_object(size_t undo_len);
+    void clear();
+};
+
+// Key prediction state of an object being lexed
+struct lex_open_object {
+    int context; // See json_symbol_table::object_keys
+    int position; // Number of keys seen so far
+    int last_key; // -1 if none yet
+};
+
+// Scratch buffers of lex(). Reused across documents by passing the same one to every call.
+struct json_lex_buffers {
+    std::vector<lex_open_object> open_objects;
+    std::string json_string; // Text of the last string token till we know whether it is a key
+    std::string json_num;
+};
+
+// Text of a token. Object keys are looked up in symbols.
+std::string_view token_text(const token_struct &tk, const json_symbol_table &symbols);
+
+// Optional schema checked alongside parsing. See json_schema.h
+struct json_schema_walker;
+
+size_t estimate_token_capacity(std::istream &inf);
+int lex(std::istream &inf, std::pmr::vector<token_struct> &token_list, json_symbol_table &symbols, 
+    json_lex_buffers &buffers);
+int parse_json_list(std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, json_symbol_table &symbols, 
+    json_schema_walker *walker = nullptr, int schema_node = -1);
+int parse_json_object(std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, json_symbol_table &symbols, 
+    json_schema_walker *walker = nullptr, int schema_node = -1);
+int validate_json(std::istream &inf, std::pmr::vector<token_struct> &token_list, json_schema_walker *walker = nullptr, 
+    json_symbol_table *symbols = nullptr, json_lex_buffers *lex_buffers = nullptr);
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include "json_parse.h"
+#include "json_schema.h"
+
+
+// Map type names used by "type" to their bits
+const std::unordered_map<std::string, unsigned int> schema_type_names = {
+    {"\"object\"", schema_type_object},
+    {"\"array\"", schema_type_array},
+    {"\"string\"", schema_type_string},
+    {"\"number\"", schema_type_number},
+    {"\"integer\"", schema_type_integer},
+    {"\"boolean\"", schema_type_boolean},
+    {"\"null\"", schema_type_null},
+};
+
+int compile_schema_object(const std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, const json_symbol_table &symbols, 
+        json_schema &schema);
+
+// Type bits a token satisfies. Integral numbers are also numbers.
+unsigned int token_type_bits(const token_struct &tk) {
+    switch (tk.tk_type) {
+        case L_BRACE:
+            return schema_type_object;
+        case L_BRACKET:
+            return schema_type_array;
+        case STRING:
+            return schema_type_string;
+        case NUMBER:
+            if (tk.tk_value.find_first_of(".eE") == std::string::npos) {
+                return schema_type_number | schema_type_integer;
+            }
+            return schema_type_number;
+        case KEYW_TRUE:
+        case KEYW_FALSE:
+            return schema_type_boolean;
+        case KEYW_NULL:
+            return schema_type_null;
+        default:
+            return 0;
+    }
+}
+
+// Number of characters in a raw string token. Escape sequences count as one character and so do
+// multi byte utf-8 sequences.
+long json_string_length(std::string_view raw) {
+    long len = 0;
+    // Skip start and end quotes
+    for (size_t i = 1; i + 1 < raw.size(); ++i) {
+        char c = raw[i];
+        if (c == '\\') {
+            i += raw[i + 1] == 'u' ? 5 : 1;
+        }
+        else if ((c & 0xC0) == 0x80) {
+            continue; // utf-8 continuation byte
+        }
+        ++len;
+    }
+    return len;
+}
+
+// Value of a number token. Numbers beyond the range of double become +-HUGE_VAL, which still compare correctly
+// against finite bounds. Return -1 if the number is out of range of double else 0.
+int json_number_value(const token_struct &tk, double &value) {
+    errno = 0;
+    value = std::strtod(tk.tk_value.c_str(), nullptr);
+    return errno == ERANGE ? -1 : 0;
+}
+
+bool enum_value_matches(const token_struct &allowed, const token_struct &tk) {
+    if (allowed.tk_type != tk.tk_type) {
+        return false;
+    }
+    if (tk.tk_type == NUMBER) {
+        double allowed_value, value;
+        if (json_number_value(allowed, allowed_value) == 0 && json_number_value(tk, value) == 0) {
+            return allowed_value == value;
+        }
+        // Can't compare out of range numbers by value. Compare their text instead.
+    }
+    return allowed.tk_value == tk.tk_value;
+}
+
+// Skip over one json value starting at *tk_index_ptr.
+void skip_schema_value(const std::pmr::vector<token_struct> &token_list, int *tk_index_ptr) {
+    int depth = 0;
+    do {
+        token_type type = token_list[*tk_index_ptr].tk_type;
+        if (type == L_BRACE || type == L_BRACKET) {
+            ++depth;
+        }
+        else if (type == R_BRACE || type == R_BRACKET) {
+            --depth;
+        }
+        (*tk_index_ptr)++;
+    } while (depth > 0 && static_cast<size_t>(*tk_index_ptr) < token_list.size());
+}
+
+// Return slot of key in node, adding a new unconstrained slot if the key is seen for the first time.
+int add_key_slot(json_schema_node &node, const std::string &key) {
+    auto it = node.key_slots.find(key);
+    if (it != node.key_slots.end()) {
+        return it->second;
+    }
+    int slot = node.slot_nodes.size();
+    node.key_slots[key] = slot;
+    node.slot_nodes.push_back(-1);
+    return slot;
+}
+
+// Compile one keyword value of node. *tk_index_ptr points at the value token.
+int compile_schema_keyword(const std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, const json_symbol_table &symbols, 
+        json_schema &schema, int node, const std::string &keyword) {
+    const token_struct &tk = token_list[*tk_index_ptr];
+    if (keyword == "\"type\"") {
+        unsigned int mask = 0;
+        if (tk.tk_type == L_BRACKET) {
+            (*tk_index_ptr)++;
+        }
+        while (static_cast<size_t>(*tk_index_ptr) < token_list.size()) {
+            const token_struct &type_tk = token_list[*tk_index_ptr];
+            (*tk_index_ptr)++;
+            auto it = schema_type_names.find(std::string {type_tk.tk_value});
+            if (type_tk.tk_type != STRING || it == schema_type_names.end()) {
+                std::cerr << "Schema: Unknown type ==> " << type_tk.tk_value << " line " << type_tk.line << " col " << type_tk.col << std::endl;
+                return -1;
+            }
+            mask |= it->second;
+            if (mask & schema_type_number) {
+                mask |= schema_type_integer; // Every integer is a number
+            }
+            if (tk.tk_type != L_BRACKET || token_list[*tk_index_ptr].tk_type == R_BRACKET) {
+                break;
+            }
+            (*tk_index_ptr)++; // comma
+        }
+        if (tk.tk_type == L_BRACKET) {
+            (*tk_index_ptr)++; // end bracket
+        }
+        schema.nodes[node].type_mask = mask;
+    }
+    else if (keyword == "\"required\"" || keyword == "\"enum\"") {
+        if (tk.tk_type != L_BRACKET) {
+            std::cerr << "Schema: Expected list for " << keyword << " line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+        (*tk_index_ptr)++;
+        json_schema_node &n = schema.nodes[node];
+        if (keyword == "\"enum\"") {
+            n.has_enum = true;
+        }
+        while (token_list[*tk_index_ptr].tk_type != R_BRACKET) {
+            const token_struct &value = token_list[*tk_index_ptr];
+            (*tk_index_ptr)++;
+            if (keyword == "\"required\"") {
+                if (value.tk_type != STRING) {
+                    std::cerr << "Schema: required keys must be strings ==> " << value.tk_value << std::endl;
+                    return -1;
+                }
+                n.required_slots.push_back(add_key_slot(n, std::string {value.tk_value}));
+            }
+            else {
+                if (value.tk_type == L_BRACE || value.tk_type == L_BRACKET) {
+                    std::cerr << "Schema: Only scalar enum values are supported line " << value.line << " col " << value.col << std::endl;
+                    return -1;
+                }
+                n.enum_values.push_back(value);
+            }
+            if (token_list[*tk_index_ptr].tk_type == COMMA) {
+                (*tk_index_ptr)++;
+            }
+        }
+        (*tk_index_ptr)++; // end bracket
+    }
+    else if (keyword == "\"properties\"") {
+        if (tk.tk_type != L_BRACE) {
+            std::cerr << "Schema: Expected object for properties line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+        (*tk_index_ptr)++;
+        while (token_list[*tk_index_ptr].tk_type != R_BRACE) {
+            std::string key {token_text(token_list[*tk_index_ptr], symbols)};
+            *tk_index_ptr += 2; // key and colon
+            if (token_list[*tk_index_ptr].tk_type != L_BRACE) {
+                std::cerr << "Schema: Expected schema object for property " << key << std::endl;
+                return -1;
+            }
+            (*tk_index_ptr)++;
+            int child = compile_schema_object(token_list, tk_index_ptr, symbols, schema);
+            if (child < 0) {
+                return -1;
+            }
+            json_schema_node &n = schema.nodes[node]; // nodes may have been reallocated by the child
+            n.slot_nodes[add_key_slot(n, key)] = child;
+            if (token_list[*tk_index_ptr].tk_type == COMMA) {
+                (*tk_index_ptr)++;
+            }
+        }
+        (*tk_index_ptr)++; // end brace
+    }
+    else if (keyword == "\"items\"") {
+        if (tk.tk_type != L_BRACE) {
+            std::cerr << "Schema: Expected schema object for items line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+        (*tk_index_ptr)++;
+        int child = compile_schema_object(token_list, tk_index_ptr, symbols, schema);
+        if (child < 0) {
+            return -1;
+        }
+        schema.nodes[node].items_node = child;
+    }
+    else if (keyword == "\"minimum\"" || keyword == "\"maximum\"" || keyword == "\"maxLength\"") {
+        if (tk.tk_type != NUMBER) {
+            std::cerr << "Schema: Expected number for " << keyword << " line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+        (*tk_index_ptr)++;
+        json_schema_node &n = schema.nodes[node];
+        double value;
+        if (json_number_value(tk, value) != 0) {
+            std::cerr << "Schema: Number out of range for " << keyword << " ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+        if (keyword == "\"minimum\"") {
+            n.has_minimum = true;
+            n.minimum = value;
+        }
+        else if (keyword == "\"maximum\"") {
+            n.has_maximum = true;
+            n.maximum = value;
+        }
+        else {
+            errno = 0;
+            n.max_length = std::strtol(tk.tk_value.c_str(), nullptr, 10);
+            if (errno == ERANGE || n.max_length < 0) {
+                std::cerr << "Schema: Invalid maxLength ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col << std::endl;
+                return -1;
+            }
+        }
+    }
+    else {
+        // Unsupported keyword. Ignore it.
+        skip_schema_value(token_list, tk_index_ptr);
+    }
+    return 0;
+}
+
+// Compile a schema object into a new node. Calling this function means we have already seen the starting '{'.
+// Return index of the compiled node else -1 on error.
+int compile_schema_object(const std::pmr::vector<token_struct> &token_list, int *tk_index_ptr, const json_symbol_table &symbols, 
+        json_schema &schema) {
+    int node = schema.nodes.size();
+    schema.nodes.emplace_back();
+    while (token_list[*tk_index_ptr].tk_type != R_BRACE) {
+        std::string keyword {token_text(token_list[*tk_index_ptr], symbols)};
+        *tk_index_ptr += 2; // keyword and colon
+        if (compile_schema_keyword(token_list, tk_index_ptr, symbols, schema, node, keyword) != 0) {
+            return -1;
+        }
+        if (token_list[*tk_index_ptr].tk_type == COMMA) {
+            (*tk_index_ptr)++;
+        }
+    }
+    (*tk_index_ptr)++; // end brace
+    return node;
+}
+
+// Load a json schema and compile it ahead of time into schema. Return 0 on success else -1.
+int compile_json_schema(std::istream &inf, json_schema &schema) {
+    std::pmr::vector<token_struct> token_list;
+    json_symbol_table symbols;
+    if (validate_json(inf, token_list, nullptr, &symbols) != 0) {
+        std::cerr << "Schema is not valid json" << std::endl;
+        return -1;
+    }
+    schema.nodes.clear();
+    int tk_list_counter = 1;
+    return compile_schema_object(token_list, &tk_list_counter, symbols, schema) == 0 ? 0 : -1;
+}
+
+
+// Check a value token against node. For '{' and '[' only the type can be checked here. Their contents are
+// checked as the parser descends into them.
+int json_schema_walker::check_value(int node, const token_struct &tk) {
+    if (node < 0) {
+        return 0;
+    }
+    const json_schema_node &n = schema.nodes[node];
+    if ((token_type_bits(tk) & n.type_mask) == 0) {
+        std::cerr << "Schema violation at '" << pointer << "': Unexpected type ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col << std::endl;
+        return -1;
+    }
+    if (n.has_enum) {
+        bool found = false;
+        for (auto &allowed: n.enum_values) {
+            if (enum_value_matches(allowed, tk)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            std::cerr << "Schema violation at '" << pointer << "': Value not in enum ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+    }
+    if (tk.tk_type == NUMBER && (n.has_minimum || n.has_maximum)) {
+        double value;
+        json_number_value(tk, value); // +-HUGE_VAL for numbers out of range compare correctly with the bounds
+        if ((n.has_minimum && value < n.minimum) || (n.has_maximum && value > n.maximum)) {
+            std::cerr << "Schema violation at '" << pointer << "': Number out of range ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col << std::endl;
+            return -1;
+        }
+    }
+    if (tk.tk_type == STRING && n.max_length >= 0 && json_string_length(tk.tk_value) > n.max_length) {
+        std::cerr << "Schema violation at '" << pointer << "': String longer than " << n.max_length << " ==> " << tk.tk_value << " line " << tk.line << " col " << tk.col << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Called at the start of an object. Return the index of its first entry in seen_slots.
+size_t json_schema_walker::begin_object(int node) {
+    size_t seen_base = seen_slots.size();
+    seen_slots.resize(seen_base + num_slots(node), false);
+    return seen_base;
+}
+
+// Called at the end of an object with the seen_slots index from begin_object(). Pops the object's entries.
+int json_schema_walker::check_required(int node, size_t seen_base) {
+    if (node < 0) {
+        return 0;
+    }
+    const json_schema_node &n = schema.nodes[node];
+    for (int slot: n.required_slots) {
+        if (!seen_slots[seen_base + slot]) {
+            for (auto &entry: n.key_slots) {
+                if (entry.second == slot) {
+                    std::cerr << "Schema violation at '" << pointer << "': Missing required key ==> " << entry.first << std::endl;
+                    break;
+                }
+            }
+            return -1;
+        }
+    }
+    seen_slots.resize(seen_base);
+    return 0;
+}
+
+void json_schema_walker::reset() {
+    pointer.clear();
+    seen_slots.clear();
+    for (auto &cache: key_slot_cache) {
+        cache.clear();
+    }
+}
+
+int json_schema_walker::key_slot(int node, const token_struct &key) {
+    if (node < 0 || key.key_id < 0) {
+        return -1;
+    }
+    std::vector<int> &cache = key_slot_cache[node];
+    if (static_cast<size_t>(key.key_id) >= cache.size()) {
+        cache.resize(key.key_id + 1, -2);
+    }
+    int &slot = cache[key.key_id];
+    if (slot == -2) {
+        const json_schema_node &n = schema.nodes[node];
+        auto it = n.key_slots.find(std::string {token_text(key, *symbols)});
+        slot = it == n.key_slots.end() ? -1 : it->second;
+    }
+    return slot;
+}
+
+int json_schema_walker::slot_node(int node, int slot) const {
+    if (node < 0 || slot < 0) {
+        return -1;
+    }
+    return schema.nodes[node].slot_nodes[slot];
+}
+
+int json_schema_walker::items_node(int node) const {
+    return node < 0 ? -1 : schema.nodes[node].items_node;
+}
+
+int json_schema_walker::num_slots(int node) const {
+    return node < 0 ? 0 : schema.nodes[node].slot_nodes.size();
+}
+
+// Keys are appended without their quotes and with '~' and '/' escaped as per RFC 6901.
+size_t json_schema_walker::push_key(const token_struct &key) {
+    size_t old_len = pointer.size();
+    pointer += '/';
+    std::string_view text = token_text(key, *symbols);
+    for (size_t i = 1; i + 1 < text.size(); ++i) {
+        char c = text[i];
+        if (c == '~') {
+            pointer += "~0";
+        }
+        else if (c == '/') {
+            pointer += "~1";
+        }
+        else {
+            pointer += c;
+        }
+    }
+    return old_len;
+}
+
+size_t json_schema_walker::push_index(int index) {
+    size_t old_len = pointer.size();
+    pointer += '/';
+    pointer += std::to_string(index);
+    return old_len;
+}
+
+void json_schema_walker::pop(size_t len) {
+    pointer.resize(len);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <istream>
+#include <unordered_map>
+#include "json_parse.h"
+
+// Bit for each json schema "type". A schema without "type" accepts all of them.
+const unsigned int schema_type_object = 1u << 0;
+const unsigned int schema_type_array = 1u << 1;
+const unsigned int schema_type_string = 1u << 2;
+const unsigned int schema_type_number = 1u << 3;
+const unsigned int schema_type_integer = 1u << 4;
+const unsigned int schema_type_boolean = 1u << 5;
+const unsigned int schema_type_null = 1u << 6;
+const unsigned int schema_type_any = (1u << 7) - 1;
+
+// One compiled (sub)schema. Supports type, required, properties, enum, minimum, maximum, maxLength and items.
+// Keys are stored as raw string tokens (including quotes) so that they compare directly against lexed keys.
+struct json_schema_node {
+    unsigned int type_mask = schema_type_any;
+
+    // Precomputed key table. Every key named in "properties" or "required" gets a slot.
+    std::unordered_map<std::string, int> key_slots;
+    std::vector<int> slot_nodes; // slot -> schema node of the property value. -1 if unconstrained.
+    std::vector<int> required_slots;
+
+    bool has_enum = false;
+    std::vector<token_struct> enum_values; // Scalars only
+
+    bool has_minimum = false;
+    bool has_maximum = false;
+    double minimum = 0;
+    double maximum = 0;
+    long max_length = -1; // -1 if absent
+
+    int items_node = -1; // schema node for list items. -1 if unconstrained.
+};
+
+// Compiled schema. nodes[0] is the root. Nodes refer to each other by index.
+struct json_schema {
+    std::vector<json_schema_node> nodes;
+};
+
+// Checks a document against a compiled schema while it is being parsed. Node index -1 accepts anything.
+// Violations are reported with the JSON Pointer of the offending value.
+struct json_schema_walker {
+    const json_schema &schema;
+    std::string pointer; // JSON Pointer of the value currently being parsed
+    const json_symbol_table *symbols = nullptr; // Key names of the document being walked
+    // Per schema node, slot of each document key by key_id. Filled the first time a key is seen in an object 
+    // of that node so that later records look up keys by an index instead of hashing them. -2 if not looked up yet.
+    std::vector<std::vector<int>> key_slot_cache;
+    // Schema keys seen in each open object, num_slots() entries per object. Kept here so that objects don't 
+    // allocate their own.
+    std::vector<bool> seen_slots;
+
+    json_schema_walker(const json_schema &schema): schema {schema}, key_slot_cache(schema.nodes.size()) {}
+
+    // Key ids are per document. Call before walking a new document.
+    void reset();
+
+    int check_value(int node, const token_struct &tk);
+    size_t begin_object(int node);
+    int check_required(int node, size_t seen_base);
+    int key_slot(int node, const token_struct &key);
+    int slot_node(int node, int slot) const;
+    int items_node(int node) const;
+    int num_slots(int node) const;
+
+    // Append a path segment to pointer. Returns the old length to pass to pop().
+    size_t push_key(const token_struct &key);
+    size_t push_index(int index);
+    void pop(size_t len);
+};
+
+int compile_json_schema(std::istream &inf, json_schema &schema);
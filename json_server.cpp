@@ -0,0 +1,374 @@
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include "json_parse.h"
+#include "json_schema.h"
+#include "json_server.h"
+
+
+// Read only view of a memory buffer as an input stream so that inline payloads can be lexed without a copy.
+struct memory_streambuf : public std::streambuf {
+    void reset(char *begin, char *end) {
+        setg(begin, begin, end);
+    }
+
+    // Seeking lets lex() pre-count tokens of a payload.
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        char *base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+        if (!(which & std::ios_base::in) || base + off < eback() || base + off > egptr()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), base + off, egptr());
+        return pos_type(base + off - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+// Diagnostics of the request the current thread is serving. nullptr outside of serve_connection().
+thread_local std::streambuf *thread_diagnostics = nullptr;
+
+// Stream buffer installed in std::cerr while serving. Lex/parse/schema messages written by a worker go to the 
+// diagnostics of its current request so that they can be sent back to the client. Other threads write to fallback.
+struct thread_streambuf : public std::streambuf {
+    std::streambuf *fallback = nullptr;
+
+    std::streambuf *target() {
+        return thread_diagnostics ? thread_diagnostics : fallback;
+    }
+    int overflow(int c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        return target()->sputc(traits_type::to_char_type(c));
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        return target()->sputn(s, n);
+    }
+    int sync() override {
+        return target()->pubsync();
+    }
+};
+
+// Route std::cerr through a thread_streambuf. Done once for the whole process.
+void route_cerr_per_thread() {
+    static std::once_flag once;
+    static thread_streambuf buf;
+    std::call_once(once, [] { buf.fallback = std::cerr.rdbuf(&buf); });
+}
+
+// Accepted client connections waiting for a worker.
+struct connection_queue {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<int> fds;
+
+    void push(int fd) {
+        {
+            std::lock_guard<std::mutex> lock {mtx};
+            fds.push_back(fd);
+        }
+        cv.notify_one();
+    }
+
+    int pop() {
+        std::unique_lock<std::mutex> lock {mtx};
+        cv.wait(lock, [this] { return !fds.empty(); });
+        int fd = fds.front();
+        fds.pop_front();
+        return fd;
+    }
+};
+
+// Read exactly n bytes. Return 0 on success, 1 if the peer closed the connection before sending anything, else -1.
+int read_full(int fd, char *buf, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = read(fd, buf + done, n - done);
+        if (r == 0) {
+            return done == 0 ? 1 : -1;
+        }
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += r;
+    }
+    return 0;
+}
+
+// Write exactly n bytes. Return 0 on success else -1.
+int write_full(int fd, const char *buf, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t r = send(fd, buf + done, n - done, MSG_NOSIGNAL);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += r;
+    }
+    return 0;
+}
+
+// Read one frame into payload. Return 0 on success, 1 on clean end of connection, else -1.
+int read_frame(int fd, char &kind, std::string &payload) {
+    char header[5];
+    int ret = read_full(fd, header, sizeof(header));
+    if (ret != 0) {
+        return ret;
+    }
+    kind = header[0];
+    uint32_t len;
+    std::memcpy(&len, header + 1, sizeof(len));
+    len = ntohl(len);
+    if (len > max_frame_payload) {
+        return -1;
+    }
+    payload.resize(len);
+    return read_full(fd, &payload[0], len) == 0 ? 0 : -1;
+}
+
+int write_frame(int fd, char kind, const std::string &payload) {
+    char header[5];
+    header[0] = kind;
+    uint32_t len = htonl(static_cast<uint32_t>(payload.size()));
+    std::memcpy(header + 1, &len, sizeof(len));
+    if (write_full(fd, header, sizeof(header)) != 0) {
+        return -1;
+    }
+    return write_full(fd, payload.data(), payload.size());
+}
+
+// Replace the path in payload with the contents of the file. Only regular files of at most max_frame_payload bytes 
+// are read, so that a path to a FIFO or a device can't hold a worker forever. Return 0 on success else -1 with error set.
+int read_path_request(std::string &payload, std::string &error) {
+    int file_fd = open(payload.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC); // Don't block opening a FIFO
+    if (file_fd < 0) {
+        error = "Unable to open file ==> " + payload;
+        return -1;
+    }
+    struct stat st;
+    if (fstat(file_fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        error = "Not a regular file ==> " + payload;
+        close(file_fd);
+        return -1;
+    }
+    if (st.st_size > max_frame_payload) {
+        error = "File too large ==> " + payload;
+        close(file_fd);
+        return -1;
+    }
+    payload.resize(st.st_size);
+    int ret = read_full(file_fd, &payload[0], payload.size());
+    close(file_fd);
+    if (ret != 0) {
+        error = "Unable to read file";
+        return -1;
+    }
+    return 0;
+}
+
+// Serve requests on one connection till the client closes it. Buffers are owned by the worker and reused across
+// requests. The payload, token list, lexer scratch and schema walker keep their capacity. Distinct keys in the symbol 
+// table, token values longer than the small string buffer and diagnostics are still allocated per request.
+void serve_connection(int fd, server_worker_buffers &buffers, json_schema_walker *walker) {
+    std::string &payload = buffers.payload;
+    char kind;
+    memory_streambuf membuf;
+    route_cerr_per_thread();
+    thread_diagnostics = buffers.diagnostics.rdbuf();
+    while (read_frame(fd, kind, payload) == 0) {
+        int ret;
+        buffers.diagnostics.str("");
+        if (kind == req_kind_inline) {
+            membuf.reset(&payload[0], &payload[0] + payload.size());
+            std::istream in {&membuf};
+            ret = validate_json(in, buffers.token_list, walker, &buffers.symbols, &buffers.lex_buffers);
+        }
+        else if (kind == req_kind_path) {
+            std::string error;
+            if (read_path_request(payload, error) != 0) {
+                if (write_frame(fd, resp_kind_error, error) != 0) break;
+                continue;
+            }
+            membuf.reset(&payload[0], &payload[0] + payload.size());
+            std::istream in {&membuf};
+            ret = validate_json(in, buffers.token_list, walker, &buffers.symbols, &buffers.lex_buffers);
+        }
+        else {
+            write_frame(fd, resp_kind_error, "Unknown request kind");
+            break;
+        }
+
+        if (write_frame(fd, ret == 0 ? resp_kind_valid : resp_kind_invalid, ret == 0 ? "" : buffers.diagnostics.str()) != 0) {
+            break;
+        }
+    }
+    thread_diagnostics = nullptr;
+    close(fd);
+}
+
+void worker_loop(connection_queue &queue, const json_schema *schema) {
+    server_worker_buffers buffers; // Warm per thread buffers
+    static const json_schema no_schema;
+    json_schema_walker walker {schema ? *schema : no_schema};
+    while (true) {
+        int fd = queue.pop();
+        if (fd < 0) {
+            return; // Server is shutting down
+        }
+        serve_connection(fd, buffers, schema ? &walker : nullptr);
+    }
+}
+
+int make_socket_addr(const std::string &socket_path, sockaddr_un &addr) {
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long ==> " << socket_path << std::endl;
+        return -1;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    return 0;
+}
+
+// Listen on socket_path and validate requests on a pool of num_workers threads. If schema is not null documents
+// must also conform to it. Only returns on error, after removing the socket.
+int run_server(const std::string &socket_path, unsigned int num_workers, const json_schema *schema) {
+    sockaddr_un addr;
+    if (make_socket_addr(socket_path, addr) != 0) {
+        return -1;
+    }
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Unable to create socket: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    // Remove a stale socket from an earlier run. Never remove anything else that happens to be at socket_path.
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "Refusing to replace " << socket_path << ": not a socket" << std::endl;
+            close(listen_fd);
+            return -1;
+        }
+        unlink(socket_path.c_str());
+    }
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "Unable to listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        close(listen_fd);
+        return -1;
+    }
+
+    if (num_workers == 0) {
+        num_workers = std::thread::hardware_concurrency();
+        if (num_workers == 0) num_workers = 1;
+    }
+    std::cout << "Listening on " << socket_path << " with " << num_workers << " workers" << std::endl;
+
+    connection_queue queue;
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < num_workers; ++i) {
+        workers.emplace_back(worker_loop, std::ref(queue), schema);
+    }
+
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cout << "Accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        // Close connections that stay idle so that they can't hold all workers
+        timeval timeout {client_timeout_seconds, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        queue.push(fd);
+    }
+
+    // Let every worker finish its connection and stop. Idle clients time out so this doesn't wait forever.
+    for (unsigned int i = 0; i < num_workers; ++i) {
+        queue.push(-1);
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return -1;
+}
+
+// Ask the server listening on socket_path to validate filename. filename "-" sends stdin as an inline payload.
+// Return 0 if the server reports valid json else -1.
+int run_client(const std::string &socket_path, const std::string &filename) {
+    char kind;
+    std::string payload;
+    if (filename == "-") {
+        kind = req_kind_inline;
+        payload.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+    else {
+        // Server may run in a different working directory. Send an absolute path.
+        char resolved[PATH_MAX];
+        if (realpath(filename.c_str(), resolved) == nullptr) {
+            std::cerr << "Unable to open file ==> " << filename << std::endl;
+            return -1;
+        }
+        kind = req_kind_path;
+        payload = resolved;
+    }
+
+    sockaddr_un addr;
+    if (make_socket_addr(socket_path, addr) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Unable to connect to " << socket_path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    if (write_frame(fd, kind, payload) != 0 || read_frame(fd, kind, payload) != 0) {
+        std::cerr << "Lost connection to server" << std::endl;
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    if (kind == resp_kind_valid) {
+        std::cout << "valid json" << std::endl;
+        return 0;
+    }
+    if (kind == resp_kind_invalid) {
+        std::cout << "invalid json" << std::endl;
+        // Same diagnostics the command line prints for this document
+        std::cerr << payload;
+        if (!payload.empty() && payload.back() != '\n') {
+            std::cerr << std::endl;
+        }
+    }
+    else {
+        std::cerr << payload << std::endl;
+    }
+    return -1;
+}
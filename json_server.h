@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory_resource>
+#include "json_parse.h"
+
+struct json_schema;
+
+// Wire protocol shared by server and client over a Unix domain socket. Every frame is
+//     1 byte kind | 4 byte payload length (network byte order) | payload
+// Request kinds carry either a path to a regular file readable by the server or the json document itself.
+// The server answers each request with one response frame whose payload is an optional message. For invalid
+// documents the message holds the diagnostics the command line would print.
+// A connection may carry any number of requests, one response per request, in order.
+const char req_kind_path = 'P';
+const char req_kind_inline = 'I';
+const char resp_kind_valid = 'V';
+const char resp_kind_invalid = 'N';
+const char resp_kind_error = 'E';
+
+// Largest payload accepted in a single frame.
+const unsigned int max_frame_payload = 64u * 1024 * 1024; // Also the largest file a path request may name
+
+// Largest --workers accepted
+const long max_workers = 1024;
+
+// Connections which send nothing (or don't read their responses) for this long are closed.
+const int client_timeout_seconds = 30;
+
+// Buffers owned by one worker and reused across the requests it serves.
+struct server_worker_buffers {
+    std::string payload;
+    std::pmr::vector<token_struct> token_list;
+    json_symbol_table symbols;
+    json_lex_buffers lex_buffers;
+    std::ostringstream diagnostics; // Lex, parse and schema messages of the current request
+};
+
+int read_frame(int fd, char &kind, std::string &payload);
+int write_frame(int fd, char kind, const std::string &payload);
+void serve_connection(int fd, server_worker_buffers &buffers, json_schema_walker *walker);
+int run_server(const std::string &socket_path, unsigned int num_workers, const json_schema *schema);
+int run_client(const std::string &socket_path, const std::string &filename);
@@ -2,7 +2,14 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <memory_resource>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "json_parse.h"
+#include "json_schema.h"
+#include "json_server.h"
+#include "json_memory.h"
 
 std::vector<std::string> test_files_list = {
     "step1/invalid.json",
@@ -16,34 +23,174 @@ std::vector<std::string> test_files_list = {
     "step4/invalid.json",
     "step4/valid.json",
     "step4/valid2.json",
+    "step5/invalid.json",
+    "step5/valid.json",
+};
+
+// Files checked against schema/schema.json
+std::vector<std::string> schema_test_files_list = {
+    "schema/valid.json",
+    "schema/invalid.json",
+    "schema/invalid2.json",
+    "schema/invalid3.json",
+    "schema/invalid4.json",
+    "schema/valid2.json",
+    "schema/invalid5.json",
+    "schema/invalid6.json",
 };
 
 void run_test(std::string filename) {
     std::cout << "Running test on file: " << filename << std::endl;
-    std::vector<token_struct> token_list;
+    std::pmr::vector<token_struct> token_list;
     std::ifstream inf {filename};
-    if (lex(inf, token_list) != 0) {
+    if (validate_json(inf, token_list) == 0) {
+        std::cout << " ==> Valid" << std::endl;
+    }
+    else {
         std::cout << " ==> Invalid" << std::endl;
-        return;
     }
+}
 
-    if (token_list.size() == 0) {
+void run_schema_test(std::string filename, const json_schema &schema) {
+    std::cout << "Running schema test on file: " << filename << std::endl;
+    std::pmr::vector<token_struct> token_list;
+    json_schema_walker walker {schema};
+    std::ifstream inf {filename};
+    if (validate_json(inf, token_list, &walker) == 0) {
+        std::cout << " ==> Valid" << std::endl;
+    }
+    else {
         std::cout << " ==> Invalid" << std::endl;
-        return;
     }
+}
 
-    if (token_list[0].tk_type != L_BRACE) {
-        std::cout << " ==> Invalid" << std::endl;
+// Pipeline requests over one connection and print the server's response to each.
+void serve_test_requests(const std::vector<std::pair<char, std::string>> &requests, json_schema_walker *walker) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        std::cout << " ==> Unable to create socketpair" << std::endl;
         return;
     }
 
-    int tk_list_counter = 1;
-    if (parse_json_object(token_list, &tk_list_counter) == 0) {
-        std::cout << " ==> Valid" << std::endl;
+    // Requests are small enough to fit in the socket buffer, so all of them can be sent before serving.
+    for (auto &request: requests) {
+        write_frame(fds[0], request.first, request.second);
     }
-    else {
-        std::cout << " ==> Invalid" << std::endl;
+    shutdown(fds[0], SHUT_WR);
+
+    server_worker_buffers buffers;
+    serve_connection(fds[1], buffers, walker);
+
+    char kind;
+    std::string message;
+    while (read_frame(fds[0], kind, message) == 0) {
+        if (!message.empty() && message.back() == '\n') {
+            message.pop_back();
+        }
+        if (kind == resp_kind_valid) {
+            std::cout << " ==> Valid" << std::endl;
+        }
+        else if (kind == resp_kind_invalid) {
+            std::cout << " ==> Invalid: " << message << std::endl;
+        }
+        else {
+            std::cout << " ==> Error: " << message << std::endl;
+        }
     }
+    std::cout << " ==> Connection closed" << std::endl;
+    close(fds[0]);
+}
+
+void run_server_test(const json_schema &schema) {
+    std::cout << "Running server test" << std::endl;
+    serve_test_requests({
+        {req_kind_inline, "{\"a\": [1, true, {\"b\": null}]}"},
+        {req_kind_inline, "{\"a\" 1}"},
+        {req_kind_path, "tests/step4/valid.json"},
+        {req_kind_path, "tests/step4/invalid.json"},
+        {req_kind_path, "tests/no_such_file.json"},
+        {req_kind_path, "/dev/zero"},
+        {'X', ""},
+        {req_kind_inline, "{}"}, // Never answered. Unknown kind closes the connection.
+    }, nullptr);
+
+    // Schema violations are reported to the client with their JSON Pointer
+    std::cout << "Running server schema test" << std::endl;
+    json_schema_walker walker {schema};
+    serve_test_requests({
+        {req_kind_path, "tests/schema/valid.json"},
+        {req_kind_path, "tests/schema/invalid.json"},
+    }, &walker);
+}
+
+// Counts the allocations made from it and passes them on to upstream.
+struct counting_resource : public std::pmr::memory_resource {
+    std::pmr::memory_resource *upstream;
+    size_t allocations = 0;
+
+    counting_resource(std::pmr::memory_resource *upstream): upstream {upstream} {}
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        ++allocations;
+        return upstream->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Lex into token lists with their own memory resource, as main does for --huge-pages. The list must be reserved 
+// once from estimate_token_capacity() and long token values must come from the same resource.
+void run_memory_resource_test() {
+    std::cout << "Running memory resource test" << std::endl;
+    std::string doc = "{\"records\": [";
+    for (int i = 0; i < 100; ++i) {
+        doc += i == 0 ? "" : ", ";
+        doc += "{\"id\": 12345678901234567890123456789, \"name\": \"a value longer than the small string buffer\", \"ok\": true}";
+    }
+    doc += "]}";
+
+    huge_page_resource huge_pages;
+    std::pmr::monotonic_buffer_resource arena {&huge_pages};
+    counting_resource counting {&arena};
+    json_symbol_table symbols;
+    json_lex_buffers lex_buffers;
+    std::istringstream in {doc};
+    size_t estimate = estimate_token_capacity(in);
+
+    // Fresh list. lex() reserves it exactly once.
+    std::pmr::vector<token_struct> token_list {&counting};
+    if (lex(in, token_list, symbols, lex_buffers) != 0) {
+        std::cout << " ==> Unable to lex" << std::endl;
+        return;
+    }
+    size_t long_values = 0;
+    size_t sso_capacity = std::pmr::string().capacity();
+    for (auto &tk: token_list) {
+        if (tk.tk_value.size() > sso_capacity) {
+            ++long_values;
+        }
+    }
+    std::cout << (token_list.size() <= estimate ? " ==> Estimate covers all tokens" : " ==> Estimate too small") << std::endl;
+    std::cout << (token_list.capacity() == estimate ? " ==> Token list reserved once" : " ==> Token list reallocated") << std::endl;
+    std::cout << (long_values > 0 && counting.allocations == long_values + 1 
+        ? " ==> Long values allocated from the token list's resource" : " ==> Long values allocated elsewhere") << std::endl;
+
+    // Warm list with enough spare capacity keeps it while lexing the document again.
+    size_t capacity = token_list.capacity();
+    token_list.clear();
+    symbols.clear();
+    in.clear();
+    in.seekg(0);
+    if (lex(in, token_list, symbols, lex_buffers) != 0) {
+        std::cout << " ==> Unable to lex" << std::endl;
+        return;
+    }
+    std::cout << (token_list.capacity() == capacity ? " ==> Warm token list kept its capacity" : " ==> Warm token list reallocated") << std::endl;
 }
 
 int main() {
@@ -52,5 +199,19 @@ int main() {
         run_test(filename);
     }
 
+    json_schema schema;
+    std::ifstream schema_inf {"tests/schema/schema.json"};
+    if (compile_json_schema(schema_inf, schema) != 0) {
+        std::cout << "Unable to compile tests/schema/schema.json" << std::endl;
+        return -1;
+    }
+    for (auto filename: schema_test_files_list) {
+        filename =  "tests/" + filename;
+        run_schema_test(filename, schema);
+    }
+
+    run_server_test(schema);
+    run_memory_resource_test();
+
     return 0;
 }
\ No newline at end of file